@@ -0,0 +1,95 @@
+/*
+* @file include/Core/DriftMonitor.hpp
+* @brief Light-source drift tracking from periodic reference readings.
+* @details
+* A full white reference is taken once as the baseline. During the campaign,
+* short reference readings at white_ref_angle are interleaved with the
+* measurement points (see scheduleDriftChecks). Each reading is turned into
+* the relative lamp output per wavelength:
+*
+*   ratio(t, lambda) = (ref(t, lambda) / it_ref) / (baseline(lambda) / it_base)
+*
+* Short readings are noisy, so the ratio is averaged over a spectral window,
+* and channels whose windowed signal is below min_snr times the estimated
+* reading noise use the all-channel (scalar) ratio instead.
+*
+* The drift at time t is a polynomial in time (fit_order) through the
+* fit_window readings closest to t, always including the two that bracket t.
+* With the default fit_window = 2 this is linear interpolation between the
+* neighbouring readings and reproduces each reading exactly; a larger window
+* turns it into a smoothing least-squares fit. Outside the covered time range
+* the drift is held at its value at the nearest end. correct() divides a
+* measured spectrum by the drift at its acquisition time.
+*/
+
+#pragma once
+
+#include <tl/expected.hpp>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "Core/Recipe.hpp"
+#include "Driver/ISpectrometer.hpp"
+#include "Math/Algebra.hpp"
+
+namespace brdf {
+
+    // One step of the measurement sequence
+    struct ScheduledStep {
+        enum class Kind { Measure, DriftCheck };
+
+        // point_index of DriftCheck steps (not a point of the recipe)
+        static constexpr std::size_t kNoPoint = std::numeric_limits<std::size_t>::max();
+
+        Kind kind;
+        std::size_t point_index; // index into Recipe::points, kNoPoint for DriftCheck
+        double integration_time_ms = 0.0; // DriftCheck: exposure of the reference reading
+    };
+
+    // True if both the incident and the outgoing directions of 'p' are within
+    // 'tolerance' [deg] of those of 'ref' (azimuth is irrelevant at theta = 0).
+    bool isNearReference(const MeasurementPoint& p, const MeasurementPoint& ref, double tolerance);
+
+    // Interleaves drift checks into the point sequence:
+    // - opportunistically when a point is near white_ref_angle and min_interval points have passed,
+    // - forced after max_interval points,
+    // - once at the end so the last points are bracketed in time.
+    std::vector<ScheduledStep> scheduleDriftChecks(
+        const std::vector<MeasurementPoint>& points,
+        const CalibrationConfig& calibration
+    );
+
+    class DriftMonitor {
+    public:
+        explicit DriftMonitor(const CalibrationConfig::Drift& config = {});
+
+        // Full white reference at time t [s]. Resets all previous readings.
+        tl::expected<void, std::string> setBaseline(double t, const driver::Spectrum& reference);
+
+        // Short reference reading at time t [s]. Readings may arrive in any order.
+        tl::expected<void, std::string> addReading(double t, const driver::Spectrum& reference);
+
+        // Relative lamp output per wavelength at time t (1.0 = baseline).
+        tl::expected<VecX, std::string> drift(double t) const;
+
+        // Returns the spectrum measured at time t with the lamp drift removed.
+        tl::expected<driver::Spectrum, std::string> correct(double t, const driver::Spectrum& measured) const;
+
+        bool hasBaseline() const { return !readings_.empty(); }
+        std::size_t numReadings() const { return readings_.size(); }
+
+    private:
+        struct Reading {
+            double time;  // [s]
+            VecX ratio;   // smoothed relative lamp output
+        };
+
+        CalibrationConfig::Drift config_;
+        VecX baseline_;                  // baseline per unit integration time
+        std::vector<double> wavelengths_;
+        std::vector<Reading> readings_;  // sorted by time
+    };
+
+} // namespace brdf
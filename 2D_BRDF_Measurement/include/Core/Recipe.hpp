@@ -20,6 +20,23 @@ namespace brdf {
         bool do_white_reference = true;
         // 白色板測定時の固定角度（通常は 45/0 や 0/45）
         MeasurementPoint white_ref_angle = { 45.0, 0.0, 0.0, 0.0 };
+
+        // 光源ドリフト追跡（白色板の再測定の代わりに簡易参照測定を挟む）
+        struct Drift {
+            bool enabled = false;
+            double angle_tolerance = 5.0;   // white_ref_angle からの方向のずれの許容差 [deg]
+            unsigned min_interval = 10;     // 近傍通過時に参照を挟む最小間隔 [点]
+            unsigned max_interval = 100;    // この点数を超えたら強制的に参照を挟む [点]
+            double integration_time_ms = 10.0; // 簡易参照測定の積分時間（DriftCheck ステップに渡す）
+
+            // ドリフトモデル（時間方向）
+            // fit_window = 2 : 前後の参照測定の間を線形補間（既定）
+            // fit_window > 2 : 近い参照測定への最小二乗フィットで平滑化（ノイズが大きい場合）
+            unsigned fit_order = 1;         // 時間多項式の次数
+            unsigned fit_window = 2;        // フィットに使う時間的に近い参照測定の数
+            unsigned spectral_window = 11;  // 比率を平滑化する波長方向の窓幅 [ch]
+            double min_snr = 10.0;          // これ未満のチャンネルは全体のスカラー比率で代用
+        } drift;
     };
 
     // 全体のレシピ
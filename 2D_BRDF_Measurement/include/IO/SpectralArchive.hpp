@@ -0,0 +1,91 @@
+/*
+* @file include/IO/SpectralArchive.hpp
+* @brief Compressed, block-indexed archive format for spectral BRDF datasets.
+* @details
+* Records (measurement point + spectrum) are grouped into fixed-size blocks.
+* Each block is encoded independently:
+*   1. Intensities are quantized with step = 2 * error_bound, so the
+*      reconstruction error of every sample is <= error_bound.
+*   2. Quantized values are predicted from their neighbours in wavelength
+*      and in the previous record of the same block (2D Lorenzo predictor).
+*   3. Residuals are zigzag + varint encoded (small residuals -> 1 byte).
+* A block index at the end of the file allows any block to be decoded
+* without touching the others. Encoding and decoding of blocks run in parallel.
+*
+* File layout (host byte order, i.e. little-endian on the x64 build targets):
+*   [Header][wavelengths][Block 0]...[Block N-1][Block index][index offset]
+*
+* @note All records in one archive must share the same wavelength grid.
+*/
+
+#pragma once
+
+#include <tl/expected.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Core/Types.hpp"
+#include "Core/Recipe.hpp"
+#include "Driver/ISpectrometer.hpp"
+
+namespace brdf::io {
+
+    // One measured sample: geometry + spectrum
+    struct SpectralRecord {
+        MeasurementPoint point;
+        driver::Spectrum spectrum;
+    };
+
+    // Encoder settings
+    struct ArchiveConfig {
+        double error_bound = 1e-6; // Max absolute error per intensity sample
+        u32 block_size = 64;       // Records per independently decodable block
+        u32 num_threads = 0;       // 0 = std::thread::hardware_concurrency()
+    };
+
+    // Writes all records to a compressed archive at 'path'.
+    tl::expected<void, std::string> writeSpectralArchive(
+        const std::string& path,
+        const std::vector<SpectralRecord>& records,
+        const ArchiveConfig& config = {}
+    );
+
+    // Random-access reader. Only the header and block index are kept in memory.
+    class SpectralArchiveReader {
+    public:
+        struct BlockEntry {
+            u64 offset;      // Byte offset of the block in the file
+            u64 size;        // Encoded size in bytes
+            u64 first_index; // Index of the first record in the block
+            u32 count;       // Number of records in the block
+        };
+
+        static tl::expected<SpectralArchiveReader, std::string> open(const std::string& path);
+
+        std::size_t numRecords() const { return num_records_; }
+        std::size_t numBlocks() const { return index_.size(); }
+        double errorBound() const { return error_bound_; }
+        const std::vector<double>& wavelengths() const { return wavelengths_; }
+
+        // Decodes a single block.
+        tl::expected<std::vector<SpectralRecord>, std::string> readBlock(std::size_t block) const;
+
+        // Decodes only the block that contains the requested record.
+        tl::expected<SpectralRecord, std::string> readRecord(std::size_t index) const;
+
+        // Decodes every block in parallel (num_threads = 0 -> hardware concurrency).
+        tl::expected<std::vector<SpectralRecord>, std::string> readAll(u32 num_threads = 0) const;
+
+    private:
+        SpectralArchiveReader() = default;
+
+        std::string path_;
+        double error_bound_ = 0.0;
+        u32 block_size_ = 0;
+        u64 num_records_ = 0;
+        std::vector<double> wavelengths_;
+        std::vector<BlockEntry> index_;
+    };
+
+} // namespace brdf::io
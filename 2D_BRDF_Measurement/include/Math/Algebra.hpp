@@ -28,6 +28,7 @@ namespace brdf {
 	using Mat2 = Eigen::Matrix<Real, 2, 2>;
 	using Mat3 = Eigen::Matrix<Real, 3, 3>;
 	using Mat4 = Eigen::Matrix<Real, 4, 4>;
+	using MatX = Eigen::Matrix<Real, Eigen::Dynamic, Eigen::Dynamic>;
 
 	using Quat = Eigen::Quaternion<Real>;
 	using Isometry3 = Eigen::Transform<Real, 3, Eigen::Isometry>; 
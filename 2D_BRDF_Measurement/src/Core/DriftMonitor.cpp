@@ -0,0 +1,199 @@
+/*
+* @file src/Core/DriftMonitor.cpp
+* @brief Light-source drift tracking from periodic reference readings.
+*/
+
+#include "Core/DriftMonitor.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "Math/MathUtils.hpp"
+
+namespace brdf {
+
+    namespace {
+
+        // Robust noise estimate of a smooth spectrum: MAD of second differences
+        // (for white noise, Var(d2) = 6 sigma^2).
+        double estimateNoise(const VecX& v) {
+            if (v.size() < 3) return 0.0;
+            std::vector<double> d2(static_cast<std::size_t>(v.size() - 2));
+            for (Eigen::Index i = 1; i + 1 < v.size(); ++i) {
+                d2[static_cast<std::size_t>(i - 1)] = std::abs(v(i - 1) - 2.0 * v(i) + v(i + 1));
+            }
+            auto mid = d2.begin() + static_cast<std::ptrdiff_t>(d2.size() / 2);
+            std::nth_element(d2.begin(), mid, d2.end());
+            return 1.4826 * (*mid) / std::sqrt(6.0);
+        }
+
+    } // namespace
+
+    bool isNearReference(const MeasurementPoint& p, const MeasurementPoint& ref, double tolerance) {
+        auto angleBetween = [](double theta_a, double phi_a, double theta_b, double phi_b) {
+            const Vec3 a = sphericalToCartesian(toRadians(theta_a), toRadians(phi_a));
+            const Vec3 b = sphericalToCartesian(toRadians(theta_b), toRadians(phi_b));
+            return toDegrees(std::acos(std::clamp(a.dot(b), Real(-1), Real(1))));
+        };
+        return angleBetween(p.theta_i, p.phi_i, ref.theta_i, ref.phi_i) <= tolerance
+            && angleBetween(p.theta_o, p.phi_o, ref.theta_o, ref.phi_o) <= tolerance;
+    }
+
+    std::vector<ScheduledStep> scheduleDriftChecks(
+        const std::vector<MeasurementPoint>& points,
+        const CalibrationConfig& calibration) {
+
+        const auto& cfg = calibration.drift;
+        std::vector<ScheduledStep> steps;
+        steps.reserve(points.size() + (cfg.max_interval ? points.size() / cfg.max_interval : 0) + 1);
+
+        std::size_t since_check = 0;
+        for (std::size_t k = 0; k < points.size(); ++k) {
+            if (cfg.enabled && since_check > 0) {
+                const bool forced = cfg.max_interval > 0 && since_check >= cfg.max_interval;
+                const bool nearby = since_check >= cfg.min_interval
+                    && isNearReference(points[k], calibration.white_ref_angle, cfg.angle_tolerance);
+                if (forced || nearby) {
+                    steps.push_back({ ScheduledStep::Kind::DriftCheck, ScheduledStep::kNoPoint, cfg.integration_time_ms });
+                    since_check = 0;
+                }
+            }
+            steps.push_back({ ScheduledStep::Kind::Measure, k });
+            ++since_check;
+        }
+
+        if (cfg.enabled && since_check > 0) {
+            steps.push_back({ ScheduledStep::Kind::DriftCheck, ScheduledStep::kNoPoint, cfg.integration_time_ms });
+        }
+        return steps;
+    }
+
+    DriftMonitor::DriftMonitor(const CalibrationConfig::Drift& config)
+        : config_(config) {
+    }
+
+    tl::expected<void, std::string> DriftMonitor::setBaseline(double t, const driver::Spectrum& reference) {
+        if (reference.integration_time_ms <= 0) return tl::unexpected("Integration time must be positive");
+        if (reference.intensities.size() == 0) return tl::unexpected("Empty reference spectrum");
+        if (static_cast<std::size_t>(reference.intensities.size()) != reference.wavelengths.size()) {
+            return tl::unexpected("Intensity / wavelength length mismatch");
+        }
+
+        baseline_ = reference.intensities / reference.integration_time_ms;
+        wavelengths_ = reference.wavelengths;
+        readings_.clear();
+        readings_.push_back({ t, VecX::Ones(baseline_.size()) });
+
+        spdlog::info("[Drift] Baseline set at t = {:.1f} s", t);
+        return {};
+    }
+
+    tl::expected<void, std::string> DriftMonitor::addReading(double t, const driver::Spectrum& reference) {
+        if (!hasBaseline()) return tl::unexpected("Baseline not set");
+        if (reference.integration_time_ms <= 0) return tl::unexpected("Integration time must be positive");
+        if (reference.wavelengths != wavelengths_) return tl::unexpected("Wavelength grid mismatch");
+        if (reference.intensities.size() != baseline_.size()) return tl::unexpected("Intensity length mismatch");
+
+        const VecX rate = reference.intensities / reference.integration_time_ms;
+        const Eigen::Index n = rate.size();
+        const double sigma = estimateNoise(rate);
+
+        // Whole-spectrum ratio, used where a channel's own signal is too weak
+        const double base_sum = baseline_.sum();
+        const double scalar = (base_sum > 0.0) ? rate.sum() / base_sum : 1.0;
+
+        // Prefix sums for the spectral moving window
+        VecX rate_cum = VecX::Zero(n + 1), base_cum = VecX::Zero(n + 1);
+        for (Eigen::Index i = 0; i < n; ++i) {
+            rate_cum(i + 1) = rate_cum(i) + rate(i);
+            base_cum(i + 1) = base_cum(i) + baseline_(i);
+        }
+
+        const Eigen::Index half = static_cast<Eigen::Index>(config_.spectral_window / 2);
+        VecX ratio(n);
+        std::size_t fallback = 0;
+        for (Eigen::Index i = 0; i < n; ++i) {
+            const Eigen::Index lo = std::max<Eigen::Index>(0, i - half);
+            const Eigen::Index hi = std::min<Eigen::Index>(n, i + half + 1);
+            const double count = static_cast<double>(hi - lo);
+            const double rate_win = rate_cum(hi) - rate_cum(lo);
+            const double base_win = base_cum(hi) - base_cum(lo);
+
+            // SNR of the window mean: mean / (sigma / sqrt(count))
+            const bool strong = base_win > 0.0
+                && rate_win / count >= config_.min_snr * sigma / std::sqrt(count);
+            if (strong) {
+                ratio(i) = rate_win / base_win;
+            }
+            else {
+                ratio(i) = scalar;
+                ++fallback;
+            }
+        }
+
+        auto it = std::upper_bound(readings_.begin(), readings_.end(), t,
+            [](double time, const Reading& r) { return time < r.time; });
+        readings_.insert(it, { t, std::move(ratio) });
+
+        spdlog::info("[Drift] Reading at t = {:.1f} s ({} total, scalar ratio {:.4f}, {} weak channels)",
+            t, readings_.size(), scalar, fallback);
+        return {};
+    }
+
+    tl::expected<VecX, std::string> DriftMonitor::drift(double t) const {
+        if (!hasBaseline()) return tl::unexpected("Baseline not set");
+
+        // Hold the model at the nearest end outside the covered time range
+        const double tc = std::clamp(t, readings_.front().time, readings_.back().time);
+
+        // Start from the reading at tc, or the pair bracketing it, then grow the
+        // window to the fit_window closest readings.
+        const std::size_t m = std::min<std::size_t>(std::max(2u, config_.fit_window), readings_.size());
+        std::size_t lo = static_cast<std::size_t>(std::lower_bound(readings_.begin(), readings_.end(), tc,
+            [](const Reading& r, double time) { return r.time < time; }) - readings_.begin());
+        std::size_t hi = lo + 1;
+        if (readings_[lo].time > tc) --lo; // tc > front().time, so lo > 0 here
+        while (hi - lo < m) {
+            if (lo == 0) ++hi;
+            else if (hi == readings_.size()) --lo;
+            else if (tc - readings_[lo - 1].time <= readings_[hi].time - tc) --lo;
+            else ++hi;
+        }
+
+        // Polynomial in normalized time centred on tc (least squares if the window
+        // exceeds order + 1); the constant term is the drift at tc.
+        const std::size_t order = std::min<std::size_t>(config_.fit_order, m - 1);
+        double scale = 0.0;
+        for (std::size_t k = lo; k < hi; ++k) scale = std::max(scale, std::abs(readings_[k].time - tc));
+        if (scale <= 0.0) scale = 1.0;
+
+        MatX A(m, order + 1), R(m, baseline_.size());
+        for (std::size_t k = 0; k < m; ++k) {
+            const double tau = (readings_[lo + k].time - tc) / scale;
+            double p = 1.0;
+            for (std::size_t j = 0; j <= order; ++j, p *= tau) A(k, j) = p;
+            R.row(k) = readings_[lo + k].ratio.transpose();
+        }
+
+        const MatX coeffs = A.completeOrthogonalDecomposition().solve(R);
+        return VecX(coeffs.row(0).transpose());
+    }
+
+    tl::expected<driver::Spectrum, std::string> DriftMonitor::correct(double t, const driver::Spectrum& measured) const {
+        if (measured.wavelengths != wavelengths_) return tl::unexpected("Wavelength grid mismatch");
+        if (measured.intensities.size() != baseline_.size()) return tl::unexpected("Intensity length mismatch");
+
+        auto d = drift(t);
+        if (!d) return tl::unexpected(d.error());
+
+        driver::Spectrum out = measured;
+        for (Eigen::Index i = 0; i < out.intensities.size(); ++i) {
+            if ((*d)(i) > EPSILON) out.intensities(i) /= (*d)(i);
+        }
+        return out;
+    }
+
+} // namespace brdf
@@ -1,9 +1,18 @@
 ﻿#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
 #include <spdlog/spdlog.h>
 
 #include "Math/Algebra.hpp"
+#include "Math/MathUtils.hpp"
 #include "Driver/Mock/MockRobotArm.hpp"
 #include "Driver/Mock/MockSpectrometer.hpp"
+#include "IO/SpectralArchive.hpp"
+#include "Core/DriftMonitor.hpp"
 
 using namespace brdf::driver;
 
@@ -91,5 +100,238 @@ int main() {
         spec.disconnect();
     }
 
+    spdlog::info("--- Testing SpectralArchive ---");
+    {
+        // 角度を少しずつ変えたダミーデータで圧縮→復元の誤差を確認
+        MockSpectrometer archSpec;
+        archSpec.connect();
+        archSpec.setIntegrationTime(1.0);
+        auto base = archSpec.measure();
+        archSpec.disconnect();
+
+        std::vector<brdf::io::SpectralRecord> records;
+        for (int k = 0; k < 100 && base; ++k) {
+            brdf::io::SpectralRecord rec{ { 45.0, 0.0, static_cast<double>(k) * 0.5, 180.0 }, *base };
+            rec.spectrum.intensities *= std::cos(brdf::toRadians(rec.point.theta_o));
+            records.push_back(rec);
+        }
+
+        brdf::io::ArchiveConfig cfg;
+        cfg.error_bound = 1e-5;
+        cfg.block_size = 16;
+
+        auto written = brdf::io::writeSpectralArchive("test_archive.brdfz", records, cfg);
+        auto reader = brdf::io::SpectralArchiveReader::open("test_archive.brdfz");
+        if (!written) {
+            spdlog::error("Archive write failed: {}", written.error());
+        }
+        else if (!reader) {
+            spdlog::error("Archive round trip failed: {}", reader.error());
+        }
+        else {
+            auto all = reader->readAll();
+            auto one = reader->readRecord(42);
+            double max_err = 0.0;
+            for (std::size_t k = 0; all && k < records.size(); ++k) {
+                max_err = std::max(max_err,
+                    ((*all)[k].spectrum.intensities - records[k].spectrum.intensities).cwiseAbs().maxCoeff());
+            }
+            if (all && one && max_err <= cfg.error_bound && one->point.theta_o == records[42].point.theta_o) {
+                spdlog::info("Verification OK: {} blocks, max error {:.3e}", reader->numBlocks(), max_err);
+            }
+            else {
+                spdlog::error("Verification FAILED: archive max error {:.3e}", max_err);
+            }
+        }
+
+        // 壊れたアーカイブ（途中で切れたファイル / 不整合なブロック索引）は open で拒否されるか
+        std::ifstream ifs("test_archive.brdfz", std::ios::binary);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        ifs.close();
+
+        std::vector<char> truncated(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(bytes.size() / 2));
+        std::ofstream("test_archive_truncated.brdfz", std::ios::binary)
+            .write(truncated.data(), static_cast<std::streamsize>(truncated.size()));
+
+        // 索引の2番目のエントリの first_index を書き換える (entry = offset, size, first_index, count)
+        std::vector<char> badIndex = bytes;
+        brdf::u64 index_offset = 0;
+        std::memcpy(&index_offset, badIndex.data() + badIndex.size() - sizeof(brdf::u64), sizeof(brdf::u64));
+        const std::size_t entry_size = 3 * sizeof(brdf::u64) + sizeof(brdf::u32);
+        const brdf::u64 bogus_first = 3;
+        std::memcpy(badIndex.data() + index_offset + entry_size + 2 * sizeof(brdf::u64), &bogus_first, sizeof(brdf::u64));
+        std::ofstream("test_archive_badindex.brdfz", std::ios::binary)
+            .write(badIndex.data(), static_cast<std::streamsize>(badIndex.size()));
+
+        // ヘッダの block_size / num_records が巨大で、ブロックが空の細工ファイル
+        std::vector<char> crafted(bytes.begin(), bytes.begin() + 8); // magic
+        auto append = [&crafted](const auto& v) {
+            const auto* p = reinterpret_cast<const char*>(&v);
+            crafted.insert(crafted.end(), p, p + sizeof(v));
+        };
+        const brdf::u64 crafted_header_end = 40;
+        append(brdf::u32{ 1 });             // version
+        append(brdf::u32{ 0xFFFFFFFF });    // block_size
+        append(brdf::u64{ 0xFFFFFFFF });    // num_records
+        append(brdf::u64{ 0 });             // wavelengths
+        append(1e-5);                       // error_bound
+        append(crafted_header_end);         // entry: offset
+        append(brdf::u64{ 0 });             //        size
+        append(brdf::u64{ 0 });             //        first_index
+        append(brdf::u32{ 0xFFFFFFFF });    //        count
+        append(crafted_header_end);         // footer: index offset
+        std::ofstream("test_archive_crafted.brdfz", std::ios::binary)
+            .write(crafted.data(), static_cast<std::streamsize>(crafted.size()));
+
+        auto badTrunc = brdf::io::SpectralArchiveReader::open("test_archive_truncated.brdfz");
+        auto badIdx = brdf::io::SpectralArchiveReader::open("test_archive_badindex.brdfz");
+        auto badCrafted = brdf::io::SpectralArchiveReader::open("test_archive_crafted.brdfz");
+        if (!badTrunc && !badIdx && !badCrafted) {
+            spdlog::info("Verification OK: corrupt archives rejected ({} / {} / {})",
+                badTrunc.error(), badIdx.error(), badCrafted.error());
+        }
+        else {
+            spdlog::error("Verification FAILED: corrupt archive was accepted");
+        }
+
+        // ブロック0の先頭サンプルを範囲外の残差に書き換える → readBlock がエラーを返すか
+        std::vector<char> badPayload = bytes;
+        brdf::u64 block0_offset = 0;
+        std::memcpy(&block0_offset, badPayload.data() + index_offset, sizeof(brdf::u64));
+        const std::size_t sample0 = block0_offset + sizeof(brdf::MeasurementPoint) + sizeof(double);
+        std::fill_n(badPayload.begin() + static_cast<std::ptrdiff_t>(sample0), 9, static_cast<char>(0xFF));
+        badPayload[sample0 + 9] = 0x01;
+        std::ofstream("test_archive_badpayload.brdfz", std::ios::binary)
+            .write(badPayload.data(), static_cast<std::streamsize>(badPayload.size()));
+
+        auto payloadReader = brdf::io::SpectralArchiveReader::open("test_archive_badpayload.brdfz");
+        auto payloadBlock = payloadReader ? payloadReader->readBlock(0)
+                                          : tl::expected<std::vector<brdf::io::SpectralRecord>, std::string>{};
+        if (payloadReader && !payloadBlock && payloadBlock.error() == "Corrupt block 0") {
+            spdlog::info("Verification OK: corrupt block payload rejected ({})", payloadBlock.error());
+        }
+        else {
+            spdlog::error("Verification FAILED: corrupt block payload was not detected");
+        }
+
+        std::filesystem::remove("test_archive.brdfz");
+        std::filesystem::remove("test_archive_truncated.brdfz");
+        std::filesystem::remove("test_archive_badindex.brdfz");
+        std::filesystem::remove("test_archive_crafted.brdfz");
+        std::filesystem::remove("test_archive_badpayload.brdfz");
+    }
+
+    spdlog::info("--- Testing DriftMonitor ---");
+    {
+        MockSpectrometer refSpec;
+        refSpec.connect();
+        auto white = refSpec.measure();
+        refSpec.disconnect();
+
+        // 光源出力が t=0 → 100s → 200s で 100% → 90% → 80% と低下したと仮定
+        // 参照測定は時間順に届かない（200s の後に 100s）
+        brdf::DriftMonitor monitor;
+        brdf::driver::Spectrum ref100 = *white, ref200 = *white;
+        ref100.intensities *= 0.9;
+        ref200.intensities *= 0.8;
+        brdf::driver::Spectrum measured = *white;
+        measured.intensities *= 0.95; // t=50s 時点の測定（出力 95%）
+
+        auto corrected = monitor.setBaseline(0.0, *white)
+            .and_then([&] { return monitor.addReading(200.0, ref200); })
+            .and_then([&] { return monitor.addReading(100.0, ref100); })
+            .and_then([&] { return monitor.correct(50.0, measured); });
+        auto held = monitor.drift(300.0); // 最後の参照測定より後は 80% のまま
+        if (corrected && (corrected->intensities - white->intensities).cwiseAbs().maxCoeff() < 1e-9
+            && held && (held->array() - 0.8).abs().maxCoeff() < 1e-9) {
+            spdlog::info("Verification OK: drift corrected by time fit (held after last reading).");
+        }
+        else {
+            spdlog::error("Verification FAILED: drift correction mismatch.");
+        }
+
+        // 時間的に単調でないドリフト: 参照測定の値をそのまま通り（補間）、範囲外は端の値を保持
+        brdf::DriftMonitor wobble;
+        auto wobbleOk = wobble.setBaseline(0.0, *white).has_value();
+        const double levels[] = { 0.90, 0.95, 0.85 };
+        for (int k = 0; k < 3; ++k) {
+            brdf::driver::Spectrum ref = *white;
+            ref.intensities *= levels[k];
+            wobbleOk = wobbleOk && wobble.addReading(100.0 * (k + 1), ref).has_value();
+        }
+        const std::pair<double, double> expectedDrift[] = {
+            { 100.0, 0.90 }, { 150.0, 0.925 }, { 200.0, 0.95 }, { 250.0, 0.90 }, { 300.0, 0.85 }, { 400.0, 0.85 }
+        };
+        for (const auto& [t, level] : expectedDrift) {
+            auto d = wobble.drift(t);
+            wobbleOk = wobbleOk && d && ((d->array() - level).abs().maxCoeff() < 1e-9);
+        }
+        if (wobbleOk) {
+            spdlog::info("Verification OK: non-monotonic drift interpolated through the readings.");
+        }
+        else {
+            spdlog::error("Verification FAILED: non-monotonic drift not reproduced.");
+        }
+
+        // 波長依存のドリフト + ノイズ: 信号の強いチャンネルは自分の比率、
+        // ノイズに埋もれた裾（780nm）は全体のスカラー比率を使うべき
+        std::mt19937 rng(12345);
+        std::normal_distribution<double> noise(0.0, 1e-3);
+        brdf::driver::Spectrum tilted = *white;
+        for (Eigen::Index i = 0; i < tilted.intensities.size(); ++i) {
+            const double factor = 0.8 + 0.2 * (tilted.wavelengths[i] - 380.0) / 400.0;
+            tilted.intensities(i) = tilted.intensities(i) * factor + noise(rng);
+        }
+        const double scalar = tilted.intensities.sum() / white->intensities.sum();
+
+        brdf::DriftMonitor spectral;
+        auto tiltDrift = spectral.setBaseline(0.0, *white)
+            .and_then([&] { return spectral.addReading(100.0, tilted); })
+            .and_then([&] { return spectral.drift(100.0); });
+        const Eigen::Index ch480 = 480 - 380, ch780 = 780 - 380;
+        if (tiltDrift && std::abs((*tiltDrift)(ch480) - 0.85) < 2e-3
+            && std::abs((*tiltDrift)(ch780) - scalar) < 1e-12 && std::abs(scalar - 0.85) > 0.02) {
+            spdlog::info("Verification OK: spectral drift {:.4f} at 480nm, scalar fallback {:.4f} at 780nm.",
+                (*tiltDrift)(ch480), (*tiltDrift)(ch780));
+        }
+        else {
+            spdlog::error("Verification FAILED: wavelength-dependent drift / weak-channel fallback.");
+        }
+
+        // 白色板角度 {45, 0, 0, 0} の近傍を通過したときに参照測定が挟まれるか
+        // phi_o = 180 でも theta_o ≈ 0 なら同じ方向なので近傍と判定されるべき
+        brdf::CalibrationConfig calib;
+        calib.drift.enabled = true;
+        calib.drift.min_interval = 5;
+        calib.drift.max_interval = 20;
+        std::vector<brdf::MeasurementPoint> points;
+        for (int k = 0; k < 50; ++k) {
+            points.push_back({ 45.0, 0.0, static_cast<double>(k % 25) * 2.0, 180.0 });
+        }
+        auto steps = brdf::scheduleDriftChecks(points, calib);
+
+        // 期待値: 点 20 (強制), 25 (近傍), 45 (強制) の前と最後に参照測定
+        std::vector<std::size_t> expected;
+        for (std::size_t k = 0; k < points.size(); ++k) {
+            if (k == 20 || k == 25 || k == 45) expected.push_back(brdf::ScheduledStep::kNoPoint);
+            expected.push_back(k);
+        }
+        expected.push_back(brdf::ScheduledStep::kNoPoint);
+
+        bool sequenceOk = steps.size() == expected.size();
+        for (std::size_t k = 0; sequenceOk && k < steps.size(); ++k) {
+            const bool isCheck = steps[k].kind == brdf::ScheduledStep::Kind::DriftCheck;
+            sequenceOk = (isCheck == (expected[k] == brdf::ScheduledStep::kNoPoint))
+                && steps[k].point_index == expected[k]
+                && (!isCheck || steps[k].integration_time_ms == calib.drift.integration_time_ms);
+        }
+        if (sequenceOk) {
+            spdlog::info("Verification OK: {} steps with drift checks before points 20, 25, 45 and at the end.", steps.size());
+        }
+        else {
+            spdlog::error("Verification FAILED: unexpected drift check schedule.");
+        }
+    }
+
     return 0;
 }
\ No newline at end of file
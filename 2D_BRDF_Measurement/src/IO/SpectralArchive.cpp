@@ -0,0 +1,350 @@
+/*
+* @file src/IO/SpectralArchive.cpp
+* @brief Block-wise quantize + predict + varint codec for spectral archives.
+*/
+
+#include "IO/SpectralArchive.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace brdf::io {
+
+    namespace {
+
+        constexpr char kMagic[8] = { 'B', 'R', 'D', 'F', 'A', 'R', 'C', '\0' };
+        constexpr u32 kVersion = 1;
+
+        // Quantized values are kept below 2^60 so predictor residuals never overflow i64
+        constexpr double kMaxQuantized = 1152921504606846976.0; // 2^60
+        constexpr i64 kMaxQuantizedInt = i64(1) << 60;
+
+        // ---- Byte buffer helpers (host byte order, little-endian on target platforms) ----
+
+        template <typename T>
+        void putPod(std::vector<char>& buf, const T& value) {
+            const auto* p = reinterpret_cast<const char*>(&value);
+            buf.insert(buf.end(), p, p + sizeof(T));
+        }
+
+        void putVarint(std::vector<char>& buf, u64 value) {
+            while (value >= 0x80) {
+                buf.push_back(static_cast<char>((value & 0x7F) | 0x80));
+                value >>= 7;
+            }
+            buf.push_back(static_cast<char>(value));
+        }
+
+        struct Cursor {
+            const char* data;
+            std::size_t size;
+            std::size_t pos = 0;
+
+            template <typename T>
+            bool getPod(T& out) {
+                if (size - pos < sizeof(T)) return false;
+                std::memcpy(&out, data + pos, sizeof(T));
+                pos += sizeof(T);
+                return true;
+            }
+
+            bool getVarint(u64& out) {
+                out = 0;
+                for (int shift = 0; shift < 64; shift += 7) {
+                    if (pos >= size) return false;
+                    const auto byte = static_cast<unsigned char>(data[pos++]);
+                    out |= static_cast<u64>(byte & 0x7F) << shift;
+                    if ((byte & 0x80) == 0) return true;
+                }
+                return false; // malformed: more than 10 bytes
+            }
+        };
+
+        u64 zigzag(i64 v) { return (static_cast<u64>(v) << 1) ^ static_cast<u64>(v >> 63); }
+        i64 unzigzag(u64 v) { return static_cast<i64>(v >> 1) ^ -static_cast<i64>(v & 1); }
+
+        // 2D Lorenzo predictor over (record, wavelength) within one block
+        i64 predict(const std::vector<i64>& q, std::size_t r, std::size_t i, std::size_t n) {
+            if (r == 0) return (i == 0) ? 0 : q[i - 1];
+            const std::size_t cur = r * n, prev = (r - 1) * n;
+            if (i == 0) return q[prev];
+            return q[prev + i] + q[cur + i - 1] - q[prev + i - 1];
+        }
+
+        // Runs fn(0..count-1) on a pool of threads. fn returns an empty string on success.
+        template <typename Fn>
+        tl::expected<void, std::string> parallelFor(std::size_t count, u32 num_threads, Fn&& fn) {
+            if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+            const std::size_t workers = std::min<std::size_t>(num_threads, count);
+
+            std::vector<std::string> errors(count);
+            std::atomic<std::size_t> next{ 0 };
+            auto work = [&]() {
+                for (std::size_t k = next++; k < count; k = next++) {
+                    errors[k] = fn(k);
+                }
+            };
+
+            if (workers <= 1) {
+                work();
+            }
+            else {
+                std::vector<std::thread> pool;
+                pool.reserve(workers);
+                for (std::size_t t = 0; t < workers; ++t) pool.emplace_back(work);
+                for (auto& th : pool) th.join();
+            }
+
+            for (const auto& e : errors) {
+                if (!e.empty()) return tl::unexpected(e);
+            }
+            return {};
+        }
+
+        std::string encodeBlock(const std::vector<SpectralRecord>& records, std::size_t first,
+                                std::size_t count, std::size_t n, double step,
+                                std::vector<char>& out) {
+            std::vector<i64> q(count * n);
+            for (std::size_t r = 0; r < count; ++r) {
+                const auto& values = records[first + r].spectrum.intensities;
+                for (std::size_t i = 0; i < n; ++i) {
+                    const double scaled = values(static_cast<Eigen::Index>(i)) / step;
+                    if (!std::isfinite(scaled) || std::abs(scaled) >= kMaxQuantized) {
+                        return "Record " + std::to_string(first + r) +
+                               ": intensity is not finite or out of range for the error bound";
+                    }
+                    q[r * n + i] = std::llround(scaled);
+                }
+            }
+
+            out.reserve(count * (sizeof(MeasurementPoint) + sizeof(double) + n));
+            for (std::size_t r = 0; r < count; ++r) {
+                const auto& rec = records[first + r];
+                putPod(out, rec.point);
+                putPod(out, rec.spectrum.integration_time_ms);
+                for (std::size_t i = 0; i < n; ++i) {
+                    putVarint(out, zigzag(q[r * n + i] - predict(q, r, i, n)));
+                }
+            }
+            return {};
+        }
+
+    } // namespace
+
+    tl::expected<void, std::string> writeSpectralArchive(
+        const std::string& path,
+        const std::vector<SpectralRecord>& records,
+        const ArchiveConfig& config) {
+
+        if (!(config.error_bound > 0.0)) return tl::unexpected("Error bound must be positive");
+        if (config.block_size == 0) return tl::unexpected("Block size must be positive");
+
+        const std::vector<double> wavelengths =
+            records.empty() ? std::vector<double>{} : records.front().spectrum.wavelengths;
+        const std::size_t n = wavelengths.size();
+        for (std::size_t k = 0; k < records.size(); ++k) {
+            const auto& s = records[k].spectrum;
+            if (s.wavelengths != wavelengths || static_cast<std::size_t>(s.intensities.size()) != n) {
+                return tl::unexpected("Record " + std::to_string(k) + ": wavelength grid mismatch");
+            }
+        }
+
+        const double step = 2.0 * config.error_bound;
+        const std::size_t num_blocks = (records.size() + config.block_size - 1) / config.block_size;
+        std::vector<std::vector<char>> blocks(num_blocks);
+
+        auto encoded = parallelFor(num_blocks, config.num_threads, [&](std::size_t b) {
+            const std::size_t first = b * config.block_size;
+            const std::size_t count = std::min<std::size_t>(config.block_size, records.size() - first);
+            return encodeBlock(records, first, count, n, step, blocks[b]);
+        });
+        if (!encoded) return tl::unexpected(encoded.error());
+
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        if (!ofs) return tl::unexpected("Cannot open file for writing: " + path);
+
+        std::vector<char> header;
+        header.insert(header.end(), std::begin(kMagic), std::end(kMagic));
+        putPod(header, kVersion);
+        putPod(header, config.block_size);
+        putPod(header, static_cast<u64>(records.size()));
+        putPod(header, static_cast<u64>(n));
+        putPod(header, config.error_bound);
+        for (double wl : wavelengths) putPod(header, wl);
+        ofs.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+        std::vector<char> index;
+        u64 offset = header.size();
+        u64 raw_bytes = 0, packed_bytes = 0;
+        for (std::size_t b = 0; b < num_blocks; ++b) {
+            const u64 first = b * config.block_size;
+            const u32 count = static_cast<u32>(std::min<u64>(config.block_size, records.size() - first));
+            putPod(index, offset);
+            putPod(index, static_cast<u64>(blocks[b].size()));
+            putPod(index, first);
+            putPod(index, count);
+
+            ofs.write(blocks[b].data(), static_cast<std::streamsize>(blocks[b].size()));
+            offset += blocks[b].size();
+            packed_bytes += blocks[b].size();
+            raw_bytes += count * (sizeof(MeasurementPoint) + sizeof(double) * (n + 1));
+        }
+        putPod(index, offset); // footer: byte offset of the block index
+        ofs.write(index.data(), static_cast<std::streamsize>(index.size()));
+
+        if (!ofs) return tl::unexpected("Write failed: " + path);
+
+        spdlog::info("[Archive] Wrote {} records in {} blocks to {} ({} -> {} bytes)",
+            records.size(), num_blocks, path, raw_bytes, packed_bytes);
+        return {};
+    }
+
+    tl::expected<SpectralArchiveReader, std::string> SpectralArchiveReader::open(const std::string& path) {
+        std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+        if (!ifs) return tl::unexpected("Cannot open file: " + path);
+        const auto file_size = static_cast<u64>(ifs.tellg());
+
+        constexpr std::size_t fixed_header = sizeof(kMagic) + 2 * sizeof(u32) + 2 * sizeof(u64) + sizeof(double);
+        if (file_size < fixed_header + sizeof(u64)) return tl::unexpected("File too small: " + path);
+
+        std::vector<char> head(fixed_header);
+        ifs.seekg(0);
+        ifs.read(head.data(), static_cast<std::streamsize>(head.size()));
+        if (std::memcmp(head.data(), kMagic, sizeof(kMagic)) != 0) {
+            return tl::unexpected("Not a spectral archive: " + path);
+        }
+
+        SpectralArchiveReader reader;
+        reader.path_ = path;
+
+        Cursor c{ head.data(), head.size(), sizeof(kMagic) };
+        u32 version = 0;
+        u64 n = 0;
+        c.getPod(version);
+        c.getPod(reader.block_size_);
+        c.getPod(reader.num_records_);
+        c.getPod(n);
+        c.getPod(reader.error_bound_);
+        if (version != kVersion) return tl::unexpected("Unsupported archive version " + std::to_string(version));
+        if (reader.block_size_ == 0 || !(reader.error_bound_ > 0.0)) return tl::unexpected("Corrupt header");
+        if (n > (file_size - fixed_header) / sizeof(double)) return tl::unexpected("Corrupt header");
+
+        reader.wavelengths_.resize(n);
+        ifs.read(reinterpret_cast<char*>(reader.wavelengths_.data()), static_cast<std::streamsize>(n * sizeof(double)));
+
+        u64 index_offset = 0;
+        ifs.seekg(static_cast<std::streamoff>(file_size - sizeof(u64)));
+        ifs.read(reinterpret_cast<char*>(&index_offset), sizeof(u64));
+        const u64 header_end = fixed_header + n * sizeof(double);
+        if (!ifs || index_offset < header_end || index_offset > file_size - sizeof(u64)) {
+            return tl::unexpected("Corrupt block index");
+        }
+
+        constexpr std::size_t entry_size = 3 * sizeof(u64) + sizeof(u32);
+        std::vector<char> raw(file_size - sizeof(u64) - index_offset);
+        if (raw.size() % entry_size != 0) return tl::unexpected("Corrupt block index");
+        ifs.seekg(static_cast<std::streamoff>(index_offset));
+        ifs.read(raw.data(), static_cast<std::streamsize>(raw.size()));
+        if (!ifs) return tl::unexpected("Failed to read block index");
+
+        // The index must describe exactly the blocks the writer produces: contiguous
+        // from the header end to the index, full-sized except the last, and each large
+        // enough for its records (point + integration time + >= 1 byte per sample).
+        const u64 min_record_bytes = sizeof(MeasurementPoint) + sizeof(double) + n;
+        const u64 num_records = reader.num_records_;
+        const u64 block_size = reader.block_size_;
+        const u64 num_blocks = num_records / block_size + (num_records % block_size != 0 ? 1 : 0);
+        if (raw.size() / entry_size != num_blocks) return tl::unexpected("Corrupt block index");
+
+        Cursor ic{ raw.data(), raw.size() };
+        reader.index_.resize(num_blocks);
+        u64 expected_offset = header_end;
+        for (u64 b = 0; b < num_blocks; ++b) {
+            auto& e = reader.index_[b];
+            ic.getPod(e.offset);
+            ic.getPod(e.size);
+            ic.getPod(e.first_index);
+            ic.getPod(e.count);
+
+            const u64 first = b * block_size;
+            const bool valid = e.first_index == first
+                && e.count == std::min(block_size, num_records - first)
+                && e.offset == expected_offset
+                && e.size <= index_offset - e.offset
+                && e.count <= e.size / min_record_bytes; // e.size >= count * min_record_bytes, no overflow
+            if (!valid) return tl::unexpected("Corrupt block index (entry " + std::to_string(b) + ")");
+            expected_offset = e.offset + e.size;
+        }
+        if (expected_offset != index_offset) return tl::unexpected("Corrupt block index (gap before index)");
+        return reader;
+    }
+
+    tl::expected<std::vector<SpectralRecord>, std::string> SpectralArchiveReader::readBlock(std::size_t block) const {
+        if (block >= index_.size()) return tl::unexpected("Block index out of range");
+        const auto& entry = index_[block];
+
+        // Each call opens its own stream so blocks can be decoded concurrently
+        std::ifstream ifs(path_, std::ios::binary);
+        if (!ifs) return tl::unexpected("Cannot open file: " + path_);
+        std::vector<char> buf(entry.size);
+        ifs.seekg(static_cast<std::streamoff>(entry.offset));
+        ifs.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        if (!ifs) return tl::unexpected("Failed to read block " + std::to_string(block));
+
+        const std::size_t n = wavelengths_.size();
+        const double step = 2.0 * error_bound_;
+        std::vector<i64> q(static_cast<std::size_t>(entry.count) * n);
+        std::vector<SpectralRecord> out(entry.count);
+
+        Cursor c{ buf.data(), buf.size() };
+        for (std::size_t r = 0; r < entry.count; ++r) {
+            auto& rec = out[r];
+            if (!c.getPod(rec.point) || !c.getPod(rec.spectrum.integration_time_ms)) {
+                return tl::unexpected("Truncated block " + std::to_string(block));
+            }
+            rec.spectrum.wavelengths = wavelengths_;
+            rec.spectrum.intensities.resize(static_cast<Eigen::Index>(n));
+            for (std::size_t i = 0; i < n; ++i) {
+                u64 code = 0;
+                if (!c.getVarint(code)) return tl::unexpected("Truncated block " + std::to_string(block));
+                // Wrap-around sum in u64; anything outside the encoder's range is corrupt
+                const i64 value = static_cast<i64>(static_cast<u64>(predict(q, r, i, n)) + static_cast<u64>(unzigzag(code)));
+                if (value <= -kMaxQuantizedInt || value >= kMaxQuantizedInt) {
+                    return tl::unexpected("Corrupt block " + std::to_string(block));
+                }
+                q[r * n + i] = value;
+                rec.spectrum.intensities(static_cast<Eigen::Index>(i)) = static_cast<double>(q[r * n + i]) * step;
+            }
+        }
+        return out;
+    }
+
+    tl::expected<SpectralRecord, std::string> SpectralArchiveReader::readRecord(std::size_t index) const {
+        if (index >= num_records_) return tl::unexpected("Record index out of range");
+        const std::size_t block = index / block_size_;
+        auto records = readBlock(block);
+        if (!records) return tl::unexpected(records.error());
+
+        const std::size_t local = index - index_[block].first_index;
+        if (local >= records->size()) return tl::unexpected("Record index out of range");
+        return std::move((*records)[local]);
+    }
+
+    tl::expected<std::vector<SpectralRecord>, std::string> SpectralArchiveReader::readAll(u32 num_threads) const {
+        std::vector<SpectralRecord> out(num_records_);
+        auto decoded = parallelFor(index_.size(), num_threads, [&](std::size_t b) -> std::string {
+            auto records = readBlock(b);
+            if (!records) return records.error();
+            std::move(records->begin(), records->end(), out.begin() + static_cast<std::ptrdiff_t>(index_[b].first_index));
+            return {};
+        });
+        if (!decoded) return tl::unexpected(decoded.error());
+        return out;
+    }
+
+} // namespace brdf::io